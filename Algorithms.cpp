@@ -8,6 +8,13 @@
 
 #include "Algorithms.h"
 #include <getopt.h>
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <new>
 
 // Read and process command line options.
 void Algorithms::getOptions(int argc, char** argv) {
@@ -18,11 +25,14 @@ void Algorithms::getOptions(int argc, char** argv) {
     opterr = false;
 
     // Use getopt to find command line options.
-    struct option longOpts[] = {{"mode",  required_argument, nullptr, 'm' },
-                                {"help",  no_argument,       nullptr, 'h' },
-                                {nullptr, 0,                 nullptr, '\0'}};
+    struct option longOpts[] = {{"mode",         required_argument, nullptr, 'm' },
+                                {"construction", required_argument, nullptr, 'c' },
+                                {"memory-limit", required_argument, nullptr, 'l' },
+                                {"workers",      required_argument, nullptr, 'w' },
+                                {"help",         no_argument,       nullptr, 'h' },
+                                {nullptr,        0,                 nullptr, '\0'}};
     
-    while ((option = getopt_long(argc, argv, "hm:", longOpts, &option_index)) != -1) {
+    while ((option = getopt_long(argc, argv, "hm:c:l:w:", longOpts, &option_index)) != -1) {
         switch (option) {
             case 'm':
                 // Sets the mode of the program to the command argument.
@@ -30,11 +40,32 @@ void Algorithms::getOptions(int argc, char** argv) {
                 // Mode cannot be empty or invalid. Will print error message and exit.
                 setMode(optarg);
                 break;
+                
+            case 'c':
+                // Sets the tour construction used by FASTTSP and to seed OPTTSP.
+                // Construction must be "INSERTION", "DOUBLETREE", or "GREEDY".
+                setConstruction(optarg);
+                break;
+                
+            case 'l':
+                // Sets the memory limit in megabytes, building the MST out of core.
+                // Memory limit must be a positive whole number, with a 'K' suffix for kilobytes.
+                setMemoryLimit(optarg);
+                break;
+                
+            case 'w':
+                // Sets the number of worker processes OPTTSP splits its search between.
+                // Number of workers must be a whole number from 1 to 64.
+                setNumWorkers(optarg);
+                break;
 
             case 'h':
                 // Print a short description of this program and its arguments.
                 cout << "Find the path for drones according to mode. "
-                << "Valid modes are 'MST', 'FASTTSP', and 'OPTTSP'.\n";
+                << "Valid modes are 'MST', 'FASTTSP', and 'OPTTSP'. "
+                << "Valid constructions are 'INSERTION', 'DOUBLETREE', and 'GREEDY'. "
+                << "A memory limit in megabytes (or kilobytes with a 'K' suffix) builds the MST out of core. "
+                << "Workers split the OPTTSP search between processes.\n";
                 exit(0);
                 break;
                 
@@ -47,10 +78,30 @@ void Algorithms::getOptions(int argc, char** argv) {
     }
 }
 
+// Helper function that makes a private directory for the files of this run.
+string Algorithms::makeTempDirectory() {
+    const char* tempDirectory = getenv("TMPDIR");
+    string directoryTemplate = string(tempDirectory ? tempDirectory : "/tmp") + "/drone-XXXXXX";
+    vector<char> directoryName(directoryTemplate.begin(), directoryTemplate.end());
+    directoryName.push_back('\0');
+    if (mkdtemp(directoryName.data()) == nullptr) {
+        cerr << "Error: Cannot create temporary directory\n";
+        exit(1);
+    }
+    return directoryName.data();
+}
+
 // Reads input describing the locations where pickups and/or deliveries occur.
 void Algorithms::readInput() {
     // Read in number of locations.
     cin >> numLocations;
+    
+    // Stream locations to disk instead if the MST is built out of core.
+    if (memoryLimit != 0 && mode == Mode::MST) {
+        readInputToDisk();
+        return;
+    }
+    
     // Reserve the vector to number of locations.
     droneLocations.reserve(numLocations);
     coordinate temp;
@@ -70,12 +121,18 @@ void Algorithms::processAlgorithm() {
     switch (mode) {
         case Mode::MST:
             checkMSTPossible();
-            mstAlgorithm();
-            printMST();
+            if (memoryLimit != 0) {
+                externalMSTAlgorithm();
+                printExternalMST();
+            }
+            else {
+                mstAlgorithm();
+                printMST();
+            }
             break;
             
         case Mode::FASTTSP:
-            fasttspAlgorithm();
+            constructTour();
             printFASTTSP();
             break;
             
@@ -92,8 +149,20 @@ void Algorithms::processAlgorithm() {
 
 // Process that creates a minimum spanning tree using linear search.
 void Algorithms::mstAlgorithm() {
-    // Resize the prim table to number of locations.
-    primTable.resize(numLocations);
+    buildPrimTable(true);
+    
+    // Total weight is the sum of the edges into each vertex but the root.
+    for (int v = 1; v < numLocations; ++ v) {
+        totalWeight += primTable[v].minEdgeWeight;
+    }
+}
+
+// Helper function that fills the prim table with a MST over every location.
+void Algorithms::buildPrimTable(bool isMST) {
+    int numVertices = static_cast<int>(droneLocations.size());
+    
+    // Reset the prim table to number of locations.
+    primTable.assign(numVertices, Prim());
     
     // Set starting vertex 0.
     primTable[0].minEdgeWeight = 0;
@@ -103,12 +172,12 @@ void Algorithms::mstAlgorithm() {
     double minDistance = INF;
     
     // Loop until every vertex has been visited.
-    while (timesTrue < numLocations) {
+    while (timesTrue < numVertices) {
         minDistance = INF;
         
         // From the set of unvisited vertices, choose the vertex k having the
         // smallest distance to current vertex.
-        for (int k = 0; k < numLocations; ++ k) {
+        for (int k = 0; k < numVertices; ++ k) {
             if (primTable[k].isVisited == 0) {
                 if (primTable[k].minEdgeWeight < minDistance) {
                     minDistance = primTable[k].minEdgeWeight;
@@ -117,19 +186,28 @@ void Algorithms::mstAlgorithm() {
             }
         }
         
+        // If no unvisited vertex can be reached, start a new tree at the first one.
+        // Only happens for tiles of the out-of-core MST split across campuses.
+        if (minDistance == INF) {
+            for (int k = 0; k < numVertices; ++ k) {
+                if (primTable[k].isVisited == 0) {
+                    currentVertex = k;
+                    break;
+                }
+            }
+        }
+        
         // Set current vertex visited.
         primTable[currentVertex].isVisited = 1;
         ++ timesTrue;
         
         // For each vertex w adjacent to curent vertex.
-        for (int w = 0; w < numLocations; ++ w) {
-            minDistance = calculateDistance(droneLocations[currentVertex], droneLocations[w]);
+        for (int w = 0; w < numVertices; ++ w) {
+            minDistance = calculateEdgeWeight(droneLocations[currentVertex], droneLocations[w], isMST);
             // If it has not been visited.
             if (primTable[w].isVisited == 0) {
                 // It's distance is smaller than (current,w).
                 if (minDistance < primTable[w].minEdgeWeight) {
-                    // Process total weight meanwhile.
-                    calculateTotalWeight(w, minDistance);
                     // Change it's min distance and preceding vertex.
                     primTable[w].minEdgeWeight = minDistance;
                     primTable[w].precedingVertex = currentVertex;
@@ -153,6 +231,470 @@ void Algorithms::printMST() {
     }
 }
 
+    // ----------------------------------------------------------------------------
+    //                               OUT-OF-CORE MST
+    // ----------------------------------------------------------------------------
+
+// Reads input locations straight into a spill file on disk.
+void Algorithms::readInputToDisk() {
+    // Check the limit leaves room for any tile before writing anything.
+    if (tileCapacity() == 0) {
+        cerr << "Error: Memory limit too small\n";
+        exit(1);
+    }
+    
+    // Make a private directory for the files of this run.
+    tileDirectory = makeTempDirectory();
+    
+    ofstream spill(tilePath("points.bin"), ios::binary);
+    TilePoint temp;
+    temp.index = 0;
+    minX = minY = INT_MAX;
+    maxX = maxY = INT_MIN;
+    
+    // While a coordinate is being read in.
+    while (cin >> temp.x) {
+        cin >> temp.y;
+        // Keep the campus flags so we can still check an MST is possible.
+        categorizeLocation(temp.x, temp.y);
+        // Grow the bounding box of every location.
+        minX = min(minX, temp.x);
+        minY = min(minY, temp.y);
+        maxX = max(maxX, temp.x);
+        maxY = max(maxY, temp.y);
+        // Append to spill file.
+        spill.write(reinterpret_cast<const char*>(&temp), sizeof(temp));
+        ++ temp.index;
+    }
+}
+
+// Process that creates a minimum spanning tree from spatial tiles kept on disk.
+void Algorithms::externalMSTAlgorithm() {
+    // Binning: Split locations into tiles small enough that any two fit in memory.
+    binTiles();
+    
+    // Local: Write the MST of each tile as candidate edges.
+    // Boundary: Write the edges crossing between each pair of adjacent tiles
+    // in the MST of both tiles together.
+    reserveTiles();
+    ofstream candidates(tilePath("candidates.bin"), ios::binary);
+    for (int tile = 0; tile < tilesPerSide * tilesPerSide; ++ tile) {
+        if (tileSizes[tile] == 0) {
+            continue;
+        }
+        droneLocations.clear();
+        tileIndices.clear();
+        loadTile(tile);
+        writeTileEdges(candidates, 0);
+        
+        // Adjacent tiles to the right and below, so each pair is only done once.
+        size_t split = droneLocations.size();
+        int tileX = tile % tilesPerSide;
+        int tileY = tile / tilesPerSide;
+        int neighborOffsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+        for (auto& offset : neighborOffsets) {
+            int neighborX = tileX + offset[0];
+            int neighborY = tileY + offset[1];
+            if (neighborX < 0 || neighborX >= tilesPerSide || neighborY >= tilesPerSide) {
+                continue;
+            }
+            int neighbor = neighborY * tilesPerSide + neighborX;
+            if (tileSizes[neighbor] == 0) {
+                continue;
+            }
+            droneLocations.resize(split);
+            tileIndices.resize(split);
+            loadTile(neighbor);
+            writeTileEdges(candidates, split);
+        }
+    }
+    candidates.close();
+    releaseTiles();
+    
+    // Merge: Run Kruskal over the candidate edges shorter than a tile side in sorted order.
+    // Any MST edge that short joins locations in the same or adjacent tiles, so it is
+    // always a candidate.
+    sortCandidates();
+    mergeCandidates();
+    
+    // Connect the trees left over with the MST edges at least a tile side long.
+    reserveTiles();
+    connectComponents();
+    releaseTiles();
+}
+
+// Print out the results of the out-of-core MST.
+void Algorithms::printExternalMST() {
+    cout << totalWeight << "\n";
+    
+    ifstream mst(tilePath("mst.bin"), ios::binary);
+    Edge edge;
+    while (mst.read(reinterpret_cast<char*>(&edge), sizeof(edge))) {
+        cout << min(edge.u, edge.v) << " " << max(edge.u, edge.v) << "\n";
+    }
+    mst.close();
+    
+    removeTileDirectory();
+}
+
+// Helper function that splits the spill file into tile files.
+void Algorithms::binTiles() {
+    long long maxSpan = findMaxSpan();
+    
+    // Start with the fewest tiles that could hold every location, doubling tiles
+    // per side until no tile is over capacity.
+    tilesPerSide = max(1, static_cast<int>(ceil(sqrt(static_cast<double>(numLocations) / static_cast<double>(tileCapacity())))));
+    while (true) {
+        // Capacity shrinks as the tile table grows.
+        size_t capacity = tileCapacity();
+        tileSizes.assign(static_cast<size_t>(tilesPerSide) * static_cast<size_t>(tilesPerSide), 0);
+        ifstream spill(tilePath("points.bin"), ios::binary);
+        TilePoint point;
+        while (spill.read(reinterpret_cast<char*>(&point), sizeof(point))) {
+            ++ tileSizes[findTile(point)];
+        }
+        if (*max_element(tileSizes.begin(), tileSizes.end()) <= capacity) {
+            break;
+        }
+        // Tiles cannot shrink past a single coordinate, so too many equal
+        // locations can never fit.
+        if (tilesPerSide >= maxSpan) {
+            cerr << "Error: Memory limit too small\n";
+            removeTileDirectory();
+            exit(1);
+        }
+        tilesPerSide *= 2;
+    }
+    
+    // Buffer locations in one buffer. Whenever it fills the buffer budget, sort it
+    // by tile and append each tile's locations to its tile file.
+    size_t bufferCapacity = max(static_cast<size_t>(1), bufferBudget() / sizeof(TilePoint));
+    vector<TilePoint> buffer;
+    buffer.reserve(bufferCapacity);
+    ifstream spill(tilePath("points.bin"), ios::binary);
+    TilePoint point;
+    bool isRead = 1;
+    while (isRead) {
+        isRead = static_cast<bool>(spill.read(reinterpret_cast<char*>(&point), sizeof(point)));
+        if (isRead) {
+            buffer.push_back(point);
+        }
+        if (buffer.size() == bufferCapacity || (!isRead && !buffer.empty())) {
+            sort(buffer.begin(), buffer.end(), [this](const TilePoint& A, const TilePoint& B) {
+                return findTile(A) < findTile(B);
+            });
+            size_t first = 0;
+            while (first < buffer.size()) {
+                int tile = findTile(buffer[first]);
+                size_t last = first;
+                while (last < buffer.size() && findTile(buffer[last]) == tile) {
+                    ++ last;
+                }
+                ofstream tileFile(tilePath(tile), ios::binary | ios::app);
+                tileFile.write(reinterpret_cast<const char*>(buffer.data() + first),
+                               static_cast<streamsize>((last - first) * sizeof(TilePoint)));
+                first = last;
+            }
+            buffer.clear();
+        }
+    }
+    spill.close();
+    remove(tilePath("points.bin").c_str());
+}
+
+// Helper function that appends the locations of a tile to drone locations.
+void Algorithms::loadTile(int tile) {
+    ifstream tileFile(tilePath(tile), ios::binary);
+    TilePoint point;
+    while (tileFile.read(reinterpret_cast<char*>(&point), sizeof(point))) {
+        droneLocations.push_back({point.x, point.y, categorizeLocation(point.x, point.y)});
+        tileIndices.push_back(point.index);
+    }
+}
+
+// Helper function that writes the MST edges of the loaded tiles as candidate edges.
+// With a split, only edges between locations on either side of it are written.
+void Algorithms::writeTileEdges(ofstream& candidates, size_t split) {
+    buildPrimTable(true);
+    
+    for (size_t v = 0; v < primTable.size(); ++ v) {
+        // Skip the root of each tree.
+        if (primTable[v].precedingVertex == -1) {
+            continue;
+        }
+        size_t u = static_cast<size_t>(primTable[v].precedingVertex);
+        if (split == 0 || (u < split) != (v < split)) {
+            Edge edge = {primTable[v].minEdgeWeight, tileIndices[u], tileIndices[v]};
+            candidates.write(reinterpret_cast<const char*>(&edge), sizeof(edge));
+        }
+    }
+}
+
+// Helper function that sorts the candidate edges into runs that fit in memory.
+void Algorithms::sortCandidates() {
+    size_t runCapacity = max(static_cast<size_t>(1), bufferBudget() / sizeof(Edge));
+    vector<Edge> run;
+    run.reserve(runCapacity);
+    
+    ifstream candidates(tilePath("candidates.bin"), ios::binary);
+    Edge edge;
+    bool isRead = 1;
+    numRuns = 0;
+    while (isRead) {
+        isRead = static_cast<bool>(candidates.read(reinterpret_cast<char*>(&edge), sizeof(edge)));
+        if (isRead) {
+            run.push_back(edge);
+        }
+        if (run.size() == runCapacity || (!isRead && !run.empty())) {
+            sort(run.begin(), run.end(), [](const Edge& A, const Edge& B) { return A.weight < B.weight; });
+            ofstream runFile(runPath(numRuns), ios::binary);
+            runFile.write(reinterpret_cast<const char*>(run.data()), static_cast<streamsize>(run.size() * sizeof(Edge)));
+            run.clear();
+            ++ numRuns;
+        }
+    }
+    candidates.close();
+    remove(tilePath("candidates.bin").c_str());
+}
+
+// Helper function that merges the sorted runs, keeping each edge that joins two trees.
+void Algorithms::mergeCandidates() {
+    // Merge runs into longer runs until few enough are left for the buffers of
+    // every run to fit in the buffer budget at once.
+    int maxRuns = max(2, static_cast<int>(bufferBudget() / (sizeof(ifstream) + BUFSIZ + sizeof(RunEdge))));
+    int firstRun = 0;
+    while (numRuns - firstRun > maxRuns) {
+        vector<ifstream> runFiles;
+        priority_queue<RunEdge, vector<RunEdge>, RunEdgeComp> smallestEdges;
+        openRuns(firstRun, firstRun + maxRuns, runFiles, smallestEdges);
+        
+        ofstream mergedRun(runPath(numRuns), ios::binary);
+        while (!smallestEdges.empty()) {
+            Edge edge = popSmallestEdge(runFiles, smallestEdges);
+            mergedRun.write(reinterpret_cast<const char*>(&edge), sizeof(Edge));
+        }
+        
+        closeRuns(firstRun, firstRun + maxRuns, runFiles);
+        firstRun += maxRuns;
+        ++ numRuns;
+    }
+    
+    fragmentParent.resize(numLocations);
+    for (int v = 0; v < numLocations; ++ v) {
+        fragmentParent[v] = v;
+    }
+    
+    vector<ifstream> runFiles;
+    priority_queue<RunEdge, vector<RunEdge>, RunEdgeComp> smallestEdges;
+    openRuns(firstRun, numRuns, runFiles, smallestEdges);
+    
+    ofstream mst(tilePath("mst.bin"), ios::binary);
+    double shortEdge = calculateTileSide();
+    while (!smallestEdges.empty() && numMSTEdges < numLocations - 1) {
+        Edge edge = popSmallestEdge(runFiles, smallestEdges);
+        
+        // Longer edges may skip over tiles, so a shorter edge missing from the
+        // candidates could be the MST edge instead.
+        if (edge.weight >= shortEdge) {
+            break;
+        }
+        
+        int fragmentU = findFragment(edge.u);
+        int fragmentV = findFragment(edge.v);
+        if (fragmentU != fragmentV) {
+            fragmentParent[fragmentU] = fragmentV;
+            totalWeight += edge.weight;
+            ++ numMSTEdges;
+            mst.write(reinterpret_cast<const char*>(&edge), sizeof(Edge));
+        }
+    }
+    
+    closeRuns(firstRun, numRuns, runFiles);
+    numRuns = 0;
+}
+
+// Helper function that opens runs first to last, starting the heap with the
+// smallest edge of each.
+void Algorithms::openRuns(int firstRun, int lastRun, vector<ifstream>& runFiles,
+                          priority_queue<RunEdge, vector<RunEdge>, RunEdgeComp>& smallestEdges) {
+    runFiles = vector<ifstream>(lastRun - firstRun);
+    vector<RunEdge> heap;
+    heap.reserve(runFiles.size());
+    smallestEdges = priority_queue<RunEdge, vector<RunEdge>, RunEdgeComp>(RunEdgeComp(), move(heap));
+    
+    for (int run = firstRun; run < lastRun; ++ run) {
+        ifstream& runFile = runFiles[run - firstRun];
+        runFile.open(runPath(run), ios::binary);
+        RunEdge runEdge;
+        runEdge.run = run - firstRun;
+        if (runFile.read(reinterpret_cast<char*>(&runEdge.edge), sizeof(Edge))) {
+            smallestEdges.push(runEdge);
+        }
+    }
+}
+
+// Helper function that pops the smallest edge of the open runs, refilling the
+// heap from the run it came from.
+Algorithms::Edge Algorithms::popSmallestEdge(vector<ifstream>& runFiles,
+                                             priority_queue<RunEdge, vector<RunEdge>, RunEdgeComp>& smallestEdges) {
+    RunEdge runEdge = smallestEdges.top();
+    smallestEdges.pop();
+    Edge edge = runEdge.edge;
+    if (runFiles[runEdge.run].read(reinterpret_cast<char*>(&runEdge.edge), sizeof(Edge))) {
+        smallestEdges.push(runEdge);
+    }
+    return edge;
+}
+
+// Helper function that closes and removes runs first to last.
+void Algorithms::closeRuns(int firstRun, int lastRun, vector<ifstream>& runFiles) {
+    for (int run = firstRun; run < lastRun; ++ run) {
+        runFiles[run - firstRun].close();
+        remove(runPath(run).c_str());
+    }
+}
+
+// Helper function that joins the trees left after merging, adding the shortest edge
+// out of each tree until one is left.
+void Algorithms::connectComponents() {
+    ofstream mst(tilePath("mst.bin"), ios::binary | ios::app);
+    int numTiles = tilesPerSide * tilesPerSide;
+    
+    vector<int> otherTiles;
+    for (int tile = 0; tile < numTiles; ++ tile) {
+        if (tileSizes[tile] != 0) {
+            otherTiles.push_back(tile);
+        }
+    }
+    
+    // The shortest edges kept for a batch of trees fill the tree budget at most.
+    size_t batchCapacity = max(static_cast<size_t>(1), treeBudget() / sizeof(TreeEdge));
+    vector<TreeEdge> batch;
+    batch.reserve(batchCapacity);
+    
+    while (numMSTEdges < numLocations - 1) {
+        int numAdded = 0;
+        int nextRoot = 0;
+        while (nextRoot < numLocations && numMSTEdges < numLocations - 1) {
+            // Take the next batch of trees by their roots, which keeps the batch sorted.
+            batch.clear();
+            for (; nextRoot < numLocations && batch.size() < batchCapacity; ++ nextRoot) {
+                if (fragmentParent[nextRoot] == nextRoot) {
+                    batch.push_back({nextRoot, {INF, -1, -1}});
+                }
+            }
+            
+            findShortestEdges(batch, otherTiles);
+            
+            // Add the shortest edges in order, skipping any that now close a cycle.
+            sort(batch.begin(), batch.end(), [this](const TreeEdge& A, const TreeEdge& B) {
+                return isShorterEdge(A.edge, B.edge);
+            });
+            for (const TreeEdge& tree : batch) {
+                if (tree.edge.weight == INF) {
+                    break;
+                }
+                int fragmentU = findFragment(tree.edge.u);
+                int fragmentV = findFragment(tree.edge.v);
+                if (fragmentU != fragmentV) {
+                    fragmentParent[fragmentU] = fragmentV;
+                    totalWeight += tree.edge.weight;
+                    ++ numMSTEdges;
+                    ++ numAdded;
+                    mst.write(reinterpret_cast<const char*>(&tree.edge), sizeof(Edge));
+                }
+            }
+        }
+        
+        // Checking campuses up front means this should never happen.
+        if (numAdded == 0) {
+            cerr << "Cannot construct MST\n";
+            removeTileDirectory();
+            exit(1);
+        }
+    }
+}
+
+// Helper function that finds the shortest edge out of each tree in the batch.
+// Each tile is compared with every other tile, nearest first, stopping once no
+// location of the next tile can be closer than the longest of the shortest edges
+// out of the batch trees in the tile.
+void Algorithms::findShortestEdges(vector<TreeEdge>& batch, vector<int>& otherTiles) {
+    for (int tile = 0; tile < tilesPerSide * tilesPerSide; ++ tile) {
+        if (tileSizes[tile] == 0) {
+            continue;
+        }
+        droneLocations.clear();
+        tileIndices.clear();
+        loadTile(tile);
+        size_t split = droneLocations.size();
+        
+        sort(otherTiles.begin(), otherTiles.end(), [this, tile](int A, int B) {
+            return calculateTileDistance(tile, A) < calculateTileDistance(tile, B);
+        });
+        double longestEdge = findLongestShortestEdge(split, batch);
+        
+        for (int other : otherTiles) {
+            // Equal distances still need comparing, since ties are broken by location.
+            if (calculateTileDistance(tile, other) > longestEdge) {
+                break;
+            }
+            droneLocations.resize(split);
+            tileIndices.resize(split);
+            if (other != tile) {
+                loadTile(other);
+            }
+            
+            for (size_t i = 0; i < split; ++ i) {
+                int fragmentI = findFragment(tileIndices[i]);
+                for (size_t j = (other == tile ? i + 1 : split); j < droneLocations.size(); ++ j) {
+                    int fragmentJ = findFragment(tileIndices[j]);
+                    if (fragmentI == fragmentJ) {
+                        continue;
+                    }
+                    double distance = calculateDistance(droneLocations[i], droneLocations[j]);
+                    Edge edge = {distance, min(tileIndices[i], tileIndices[j]), max(tileIndices[i], tileIndices[j])};
+                    updateShortestEdge(fragmentI, edge, batch);
+                    // Only trees in this tile are updated from other tiles, since
+                    // each tile gets its own turn.
+                    if (other == tile) {
+                        updateShortestEdge(fragmentJ, edge, batch);
+                    }
+                }
+            }
+            longestEdge = findLongestShortestEdge(split, batch);
+        }
+    }
+}
+
+// Helper function that gives the longest of the shortest edges found out of each
+// batch tree in the first tile loaded. Infinity if a tree has none yet, or -1 if
+// no batch tree is in the tile.
+double Algorithms::findLongestShortestEdge(size_t split, vector<TreeEdge>& batch) {
+    double longestEdge = -1;
+    for (size_t i = 0; i < split; ++ i) {
+        TreeEdge* tree = findBatchTree(findFragment(tileIndices[i]), batch);
+        if (tree != nullptr) {
+            longestEdge = max(longestEdge, tree->edge.weight);
+        }
+    }
+    return longestEdge;
+}
+
+// Helper function that removes every file of the out-of-core MST and its directory.
+void Algorithms::removeTileDirectory() {
+    remove(tilePath("points.bin").c_str());
+    remove(tilePath("candidates.bin").c_str());
+    remove(tilePath("mst.bin").c_str());
+    for (size_t tile = 0; tile < tileSizes.size(); ++ tile) {
+        remove(tilePath(static_cast<int>(tile)).c_str());
+    }
+    for (int run = 0; run < numRuns; ++ run) {
+        remove(runPath(run).c_str());
+    }
+    rmdir(tileDirectory.c_str());
+}
+
     // ----------------------------------------------------------------------------
     //                                   FASTTSP
     // ----------------------------------------------------------------------------
@@ -203,6 +745,136 @@ void Algorithms::printFASTTSP() {
     cout << "\n";
 }
 
+    // ----------------------------------------------------------------------------
+    //                              TOUR CONSTRUCTION
+    // ----------------------------------------------------------------------------
+
+// Process that creates a Hamiltonian Cycle using the construction given.
+void Algorithms::constructTour() {
+    switch (construction) {
+        case Construction::Insertion:
+            fasttspAlgorithm();
+            break;
+            
+        case Construction::DoubleTree:
+            doubleTreeAlgorithm();
+            break;
+            
+        case Construction::Greedy:
+            greedyEdgeAlgorithm();
+            break;
+    }
+}
+
+// Process that creates a Hamiltonian Cycle by shortcutting a preorder walk of the MST.
+void Algorithms::doubleTreeAlgorithm() {
+    // Build the MST ignoring campus borders, as in FAST and OPT.
+    buildPrimTable(false);
+    
+    // Turn the preceding vertices into children of each vertex.
+    vector<vector<int>> children(numLocations);
+    for (int v = 1; v < numLocations; ++ v) {
+        children[primTable[v].precedingVertex].push_back(v);
+    }
+    // Clear the prim table so OPTTSP can reuse it when bounding.
+    primTable.clear();
+    
+    // Walk the tree in preorder starting at 0, skipping vertices already visited.
+    partialTour.reserve(numLocations);
+    vector<int> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        int currentVertex = stack.back();
+        stack.pop_back();
+        partialTour.push_back(currentVertex);
+        
+        // Push children in reverse so smaller children are visited first.
+        for (auto it = children[currentVertex].rbegin(); it != children[currentVertex].rend(); ++ it) {
+            stack.push_back(*it);
+        }
+    }
+}
+
+// Process that creates a Hamiltonian Cycle by greedily matching the shortest edges.
+void Algorithms::greedyEdgeAlgorithm() {
+    tourDegree.assign(numLocations, 0);
+    tourNeighbors.assign(numLocations, vector<int>());
+    fragmentParent.resize(numLocations);
+    for (int v = 0; v < numLocations; ++ v) {
+        fragmentParent[v] = v;
+    }
+    
+    // Repeat until the paths join into one, each round only using locations that
+    // are still the end of a path so the candidates stay a few per location.
+    int numEdges = 0;
+    vector<int> endpoints;
+    vector<int> endpointFragments;
+    vector<Edge> neighbors;
+    while (numEdges < numLocations - 1) {
+        endpoints.clear();
+        endpointFragments.clear();
+        for (int v = 0; v < numLocations; ++ v) {
+            if (tourDegree[v] < 2) {
+                endpoints.push_back(v);
+                endpointFragments.push_back(findFragment(v));
+            }
+        }
+        
+        // Candidates: The edges from each endpoint to its nearest endpoints of other paths.
+        vector<Edge> candidateEdges;
+        candidateEdges.reserve(endpoints.size() * static_cast<size_t>(numCandidates));
+        neighbors.resize(endpoints.size());
+        for (size_t i = 0; i < endpoints.size(); ++ i) {
+            int m = 0;
+            for (size_t j = 0; j < endpoints.size(); ++ j) {
+                if (endpointFragments[j] != endpointFragments[i]) {
+                    neighbors[m ++] = {calculateCost(droneLocations[endpoints[i]], droneLocations[endpoints[j]]),
+                                       min(endpoints[i], endpoints[j]), max(endpoints[i], endpoints[j])};
+                }
+            }
+            int numNeighbors = min(numCandidates, m);
+            if (numNeighbors == 0) {
+                continue;
+            }
+            nth_element(neighbors.begin(), neighbors.begin() + (numNeighbors - 1), neighbors.begin() + m,
+                        [](const Edge& A, const Edge& B) { return A.weight < B.weight; });
+            candidateEdges.insert(candidateEdges.end(), neighbors.begin(), neighbors.begin() + numNeighbors);
+        }
+        priority_queue<Edge, vector<Edge>, EdgeComp> candidates(EdgeComp(), move(candidateEdges));
+        
+        // Matching: Add the shortest candidate edges that keep the tour a set of paths.
+        while (!candidates.empty() && numEdges < numLocations - 1) {
+            numEdges += addGreedyEdge(candidates.top());
+            candidates.pop();
+        }
+    }
+    
+    // Close the cycle by joining the two ends of the single remaining path.
+    endpoints.clear();
+    for (int v = 0; v < numLocations; ++ v) {
+        if (tourDegree[v] < 2) {
+            endpoints.push_back(v);
+        }
+    }
+    tourNeighbors[endpoints.front()].push_back(endpoints.back());
+    tourNeighbors[endpoints.back()].push_back(endpoints.front());
+    
+    // Walk the cycle starting at 0.
+    partialTour.reserve(numLocations);
+    partialTour.push_back(0);
+    int previousVertex = -1;
+    int currentVertex = 0;
+    while (static_cast<int>(partialTour.size()) < numLocations) {
+        int nextVertex = tourNeighbors[currentVertex][0];
+        if (nextVertex == previousVertex) {
+            nextVertex = tourNeighbors[currentVertex][1];
+        }
+        partialTour.push_back(nextVertex);
+        previousVertex = currentVertex;
+        currentVertex = nextVertex;
+    }
+}
+
     // ----------------------------------------------------------------------------
     //                                   OPTTSP
     // ----------------------------------------------------------------------------
@@ -212,21 +884,24 @@ void Algorithms::opttspAlgorithm() {
     // Process Distance Matrix.
     processDistanceMatrix();
     // Find upper bound.
-    fasttspAlgorithm();
-    calculateTotalWeight();
-    upperBound = totalWeight;
+    constructTour();
+    orientTour(partialTour);
     bestPath = partialTour;
+    bestWeight = calculatePathWeight(bestPath);
+    upperBound = bestWeight;
+    tieTolerance = upperBound * 1e-9;
    
     
     totalWeight = 0; // Reset total weight after assigning upper bound
-    size_t permLength = 1;
-    genPerms(permLength);
-    
-    
-    totalWeight = 0;
-    for (int i = 0; i < numLocations; ++ i) {
-        totalWeight += distanceMatrix[bestPath[i]][bestPath[(i + 1) % numLocations]];
+    if (numWorkers > 1) {
+        shardedGenPerms();
     }
+    else {
+        size_t permLength = 1;
+        genPerms(permLength);
+    }
+    
+    totalWeight = bestWeight;
 }
 
 
@@ -234,15 +909,28 @@ void Algorithms::genPerms(size_t permLength) {
     if (permLength == partialTour.size()) {
       // Add weight of last edge.
       totalWeight += distanceMatrix[partialTour[permLength - 1]][0];
-      if (totalWeight < upperBound) {
-          upperBound = totalWeight;
-          bestPath = partialTour;
+      // Keep ties too, so every search settles on the same tour.
+      if (totalWeight <= upperBound + tieTolerance) {
+          vector<int> path = partialTour;
+          orientTour(path);
+          double weight = calculatePathWeight(path);
+          if (isBetterTour(path, weight)) {
+              bestPath = path;
+              bestWeight = weight;
+          }
+          if (weight < upperBound) {
+              upperBound = weight;
+              publishSharedBound();
+          }
       }
       // Subtract weight of last edge.
       totalWeight -= distanceMatrix[partialTour[permLength - 1]][0];
       return;
     }
    
+    // Prune with the best tour any worker has found so far.
+    pullSharedBound();
+    
     if (!promising(permLength)) {
         return;
     }
@@ -258,6 +946,136 @@ void Algorithms::genPerms(size_t permLength) {
   }
 }
 
+// Process that splits genPerms between worker processes through shard files.
+void Algorithms::shardedGenPerms() {
+    // Bound: Share the upper bound and the next shard to claim between every process.
+    void* shared = mmap(nullptr, sizeof(SharedSearch), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        cerr << "Error: Cannot start workers\n";
+        exit(1);
+    }
+    sharedSearch = new (shared) SharedSearch;
+    sharedSearch->upperBound = upperBound;
+    sharedSearch->nextShard = 0;
+    
+    // Shard: Go deep enough that there are plenty more prefixes than workers,
+    // then write each promising prefix to the shard files in turn.
+    shardDepth = 1;
+    size_t numPrefixes = 1;
+    while (numPrefixes < static_cast<size_t>(64 * numWorkers) && shardDepth < static_cast<size_t>(numLocations - 1)) {
+        numPrefixes *= static_cast<size_t>(numLocations) - shardDepth;
+        ++ shardDepth;
+    }
+    shardDirectory = makeTempDirectory();
+    numShards = 8 * numWorkers;
+    vector<ofstream> shardFiles(numShards);
+    for (int shard = 0; shard < numShards; ++ shard) {
+        shardFiles[shard].open(shardPath(shard), ios::binary);
+    }
+    numPrefixes = 0;
+    genShards(1, shardFiles, numPrefixes);
+    shardFiles.clear();
+    
+    // Search: Start the workers, each claiming shards until none are left.
+    cout.flush();
+    vector<pid_t> workers;
+    for (int worker = 0; worker < numWorkers; ++ worker) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            runWorker(worker);
+            _exit(0);
+        }
+        else if (pid < 0) {
+            cerr << "Error: Cannot start workers\n";
+            break;
+        }
+        workers.push_back(pid);
+    }
+    bool isFailed = static_cast<int>(workers.size()) < numWorkers;
+    for (pid_t pid : workers) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            isFailed = 1;
+        }
+    }
+    
+    // Merge: Keep the best tour found by any worker, breaking ties the same way they do.
+    for (int worker = 0; worker < numWorkers && !isFailed; ++ worker) {
+        ifstream result(shardPath("result-" + to_string(worker) + ".bin"), ios::binary);
+        vector<int> path(numLocations);
+        if (result.read(reinterpret_cast<char*>(path.data()), static_cast<streamsize>(path.size() * sizeof(int)))) {
+            double weight = calculatePathWeight(path);
+            if (isBetterTour(path, weight)) {
+                bestWeight = weight;
+                bestPath = path;
+            }
+        }
+    }
+    
+    for (int shard = 0; shard < numShards; ++ shard) {
+        remove(shardPath(shard).c_str());
+    }
+    for (int worker = 0; worker < numWorkers; ++ worker) {
+        remove(shardPath("result-" + to_string(worker) + ".bin").c_str());
+    }
+    rmdir(shardDirectory.c_str());
+    sharedSearch->~SharedSearch();
+    munmap(shared, sizeof(SharedSearch));
+    sharedSearch = nullptr;
+    
+    if (isFailed) {
+        cerr << "Error: Worker failed\n";
+        exit(1);
+    }
+}
+
+// Helper function that writes every promising prefix of the shard depth to the shard files.
+void Algorithms::genShards(size_t permLength, vector<ofstream>& shardFiles, size_t& numPrefixes) {
+    if (permLength == shardDepth) {
+        shardFiles[numPrefixes % shardFiles.size()].write(reinterpret_cast<const char*>(partialTour.data()),
+                                                          static_cast<streamsize>(partialTour.size() * sizeof(int)));
+        ++ numPrefixes;
+        return;
+    }
+    
+    if (!promising(permLength)) {
+        return;
+    }
+    
+    for (size_t i = permLength; i < partialTour.size(); ++ i) {
+        swap(partialTour[permLength], partialTour[i]);
+        totalWeight += distanceMatrix[partialTour[permLength]][partialTour[permLength - 1]];
+        
+        genShards(permLength + 1, shardFiles, numPrefixes);
+        
+        totalWeight -= distanceMatrix[partialTour[permLength]][partialTour[permLength - 1]];
+        swap(partialTour[permLength], partialTour[i]);
+    }
+}
+
+// Helper function that runs genPerms on every prefix of the shards a worker claims,
+// then writes the best tour it found, if any, to its result file.
+void Algorithms::runWorker(int worker) {
+    bestPath.clear();
+    bestWeight = INF;
+    
+    int shard = 0;
+    while ((shard = sharedSearch->nextShard.fetch_add(1)) < numShards) {
+        ifstream shardFile(shardPath(shard), ios::binary);
+        while (shardFile.read(reinterpret_cast<char*>(partialTour.data()), static_cast<streamsize>(partialTour.size() * sizeof(int)))) {
+            // Weight of the edges in the prefix.
+            totalWeight = 0;
+            for (size_t i = 1; i < shardDepth; ++ i) {
+                totalWeight += distanceMatrix[partialTour[i]][partialTour[i - 1]];
+            }
+            genPerms(shardDepth);
+        }
+    }
+    
+    ofstream result(shardPath("result-" + to_string(worker) + ".bin"), ios::binary);
+    result.write(reinterpret_cast<const char*>(bestPath.data()), static_cast<streamsize>(bestPath.size() * sizeof(int)));
+}
+
 
 // Print out the results of OPTTSP.
 void Algorithms::printOPTTSP() {
@@ -11,6 +11,10 @@
 #include <iostream>
 #include <math.h>
 #include <limits>
+#include <queue>
+#include <algorithm>
+#include <fstream>
+#include <atomic>
 
 using namespace std;
 
@@ -37,6 +41,19 @@ public:
     // Print out the results of MST.
     void printMST();
     
+    // ----------------------------------------------------------------------------
+    //                               OUT-OF-CORE MST
+    // ----------------------------------------------------------------------------
+    
+    // Reads input locations straight into a spill file on disk.
+    void readInputToDisk();
+    
+    // Process that creates a minimum spanning tree from spatial tiles kept on disk.
+    void externalMSTAlgorithm();
+    
+    // Print out the results of the out-of-core MST.
+    void printExternalMST();
+    
     // ----------------------------------------------------------------------------
     //                                   FASTTSP
     // ----------------------------------------------------------------------------
@@ -47,6 +64,22 @@ public:
     // Print out the results of FASTTSP.
     void printFASTTSP();
     
+    // ----------------------------------------------------------------------------
+    //                              TOUR CONSTRUCTION
+    // ----------------------------------------------------------------------------
+    
+    // Process that creates a Hamiltonian Cycle using the construction given.
+    void constructTour();
+    
+    // Process that creates a Hamiltonian Cycle by shortcutting a preorder walk of the MST.
+    // Within twice the optimal tour length since distances obey the triangle inequality.
+    void doubleTreeAlgorithm();
+    
+    // Process that creates a Hamiltonian Cycle by greedily matching the shortest edges.
+    // Only the nearest path ends of each path end are candidates, so unlike matching
+    // over every edge there is no guaranteed bound on the tour length.
+    void greedyEdgeAlgorithm();
+    
     // ----------------------------------------------------------------------------
     //                                   OPTTSP
     // ----------------------------------------------------------------------------
@@ -56,6 +89,9 @@ public:
     
     void genPerms(size_t permLength);
     
+    // Process that splits genPerms between worker processes through shard files.
+    void shardedGenPerms();
+    
     // Print out the results of OPTTSP.
     void printOPTTSP();
     
@@ -79,6 +115,10 @@ private:
     enum class Mode : char {MST, FASTTSP, OPTTSP};
     Mode mode;
     
+    // Enumerated variable for the tour construction used by FASTTSP and OPTTSP.
+    enum class Construction : char {Insertion, DoubleTree, Greedy};
+    Construction construction = Construction::Insertion;
+    
     // Enumerated variable for what area each location is in.
     enum class Location : char {Normal, Border, Medical};
     
@@ -95,20 +135,118 @@ private:
     struct Prim {
         bool isVisited = 0;
         double minEdgeWeight = INF;
-        int precedingVertex;
+        int precedingVertex = -1;
     };
     
     // Prim table used for MST algorithm.
     vector<Prim> primTable;
     
+    // Candidate edge between two locations. (Greedy)
+    struct Edge {
+        double weight;
+        int u;
+        int v;
+    };
+    
+    // Functor that orders the candidate edge heap by smallest weight first.
+    struct EdgeComp {
+        bool operator()(const Edge& A, const Edge& B) const {
+            return A.weight > B.weight;
+        }
+    };
+    
+    // Number of nearest path ends of each path end used as candidate edges per round. (Greedy)
+    static constexpr int numCandidates = 10;
+    
+    // Degree, fragment and neighbors of each location in the greedy tour.
+    vector<int> tourDegree;
+    vector<int> fragmentParent;
+    vector<vector<int>> tourNeighbors;
+    
+    // Memory limit in bytes for the out-of-core MST. Zero keeps every location in memory.
+    // Covers the fragment of every location, the tile table, and the location, edge,
+    // tree, and file buffers of each pass.
+    size_t memoryLimit = 0;
+    
+    // Directory holding the spill, tile, run, and edge files of the out-of-core MST.
+    string tileDirectory;
+    
+    // Location as stored in the spill and tile files.
+    struct TilePoint {
+        int index;
+        int x;
+        int y;
+    };
+    
+    // Candidate edge and the sorted run it was read from. (Out-of-core MST)
+    struct RunEdge {
+        Edge edge;
+        int run;
+    };
+    
+    // Shortest edge found out of a tree, by the root of the tree. (Out-of-core MST)
+    struct TreeEdge {
+        int root;
+        Edge edge;
+    };
+    
+    // Functor that orders the run merge heap by smallest weight first.
+    struct RunEdgeComp {
+        bool operator()(const RunEdge& A, const RunEdge& B) const {
+            return A.edge.weight > B.edge.weight;
+        }
+    };
+    
+    // Bounding box of every location, split into a square grid of tiles.
+    int minX = 0;
+    int minY = 0;
+    int maxX = 0;
+    int maxY = 0;
+    int tilesPerSide = 1;
+    
+    // Number of locations in each tile, and the sorted runs of candidate edges.
+    vector<size_t> tileSizes;
+    int numRuns = 0;
+    
+    // Global index of each location of the tiles loaded into drone locations.
+    vector<int> tileIndices;
+    
+    // Number of edges found for the out-of-core MST.
+    int numMSTEdges = 0;
+    
     // Vector for TSP location order.
     vector<int> partialTour;
     
     // FOR OPTTSP STUFF
     vector<int> bestPath;
+    double bestWeight = INF;
     double upperBound;
+    
+    // Tours within this much of the best weight are ties, broken by the
+    // lexicographically smallest tour so the result never depends on search order.
+    double tieTolerance = 0;
     vector<vector<double>> distanceMatrix;
     
+    // Number of worker processes OPTTSP splits its search between.
+    int numWorkers = 1;
+    
+    // Directory holding the shard and result files, the number of shards, and
+    // the length of the prefix each shard record starts with. (Sharded OPTTSP)
+    string shardDirectory;
+    int numShards = 0;
+    size_t shardDepth = 1;
+    
+    // Search state every worker shares through shared memory. (Sharded OPTTSP)
+    struct SharedSearch {
+        atomic<double> upperBound;
+        atomic<int> nextShard;
+    };
+    static_assert(atomic<double>::is_always_lock_free && atomic<int>::is_always_lock_free,
+                  "Shared search must be lock free to share between processes");
+    
+    // Shared search while genPerms is split between workers, otherwise null.
+    SharedSearch* sharedSearch = nullptr;
+    
     // ----------------------------------------------------------------------------
     //                              Helper Functions
     // ----------------------------------------------------------------------------
@@ -134,6 +272,49 @@ private:
         }
     }
  
+    // Helper function to set construction and check if construction argument is valid.
+    void setConstruction(const string& constructionInput) {
+        if (constructionInput == "INSERTION") {
+            construction = Construction::Insertion;
+        }
+        else if (constructionInput == "DOUBLETREE") {
+            construction = Construction::DoubleTree;
+        }
+        else if (constructionInput == "GREEDY") {
+            construction = Construction::Greedy;
+        }
+        else {
+            cerr << "Error: Invalid construction\n";
+            exit(1);
+        }
+    }
+    
+    // Helper function to set memory limit and check if memory limit argument is valid.
+    void setMemoryLimit(const string& limitInput) {
+        // Memory limit is given in megabytes, or in kilobytes with a 'K' suffix.
+        bool isKilobytes = !limitInput.empty() && limitInput.back() == 'K';
+        string amount = isKilobytes ? limitInput.substr(0, limitInput.size() - 1) : limitInput;
+        if (amount.empty() || amount.find_first_not_of("0123456789") != string::npos
+            || amount.size() > 9 || stoul(amount) == 0) {
+            cerr << "Error: Invalid memory limit\n";
+            exit(1);
+        }
+        memoryLimit = stoul(amount) * 1024 * (isKilobytes ? 1 : 1024);
+    }
+    
+    // Helper function to set number of workers and check if workers argument is valid.
+    void setNumWorkers(const string& workersInput) {
+        if (workersInput.empty() || workersInput.find_first_not_of("0123456789") != string::npos
+            || workersInput.size() > 2 || stoi(workersInput) < 1 || stoi(workersInput) > 64) {
+            cerr << "Error: Invalid number of workers\n";
+            exit(1);
+        }
+        numWorkers = stoi(workersInput);
+    }
+    
+    // Helper function that makes a private directory for the files of this run.
+    string makeTempDirectory();
+    
     // Helper function to determine what part of campus location is in.
     Location categorizeLocation(int x, int y) {
         // If both x and y are negative (apart of the 3rd quadrant), in medical campus.
@@ -172,15 +353,10 @@ private:
         
     }
     
-    // Helper function that readjusts total weight in MST algorithm.
-    void calculateTotalWeight(const int w, const double distance) {
-        if (primTable[w].minEdgeWeight != INF) {
-            totalWeight -= primTable[w].minEdgeWeight;
-            totalWeight += distance;
-        }
-        else {
-            totalWeight += distance;
-        }
+    // Helper function that calculates distance between two points, respecting
+    // campus borders only when building the MST itself.
+    double calculateEdgeWeight(const coordinate& A, const coordinate& B, bool isMST) {
+        return isMST ? calculateDistance(A, B) : calculateCost(A, B);
     }
     
     // Helper function that readjusts total weight in MST algorithm.
@@ -198,6 +374,9 @@ private:
     void checkMSTPossible() {
         if (isNormal && isMedical && !isBorder) {
             cerr << "Cannot construct MST\n";
+            if (!tileDirectory.empty()) {
+                removeTileDirectory();
+            }
             exit(1);
         }
     }
@@ -220,6 +399,246 @@ private:
         }
     }
     
+    // Helper function that fills the prim table with a MST over every location.
+    // Unreachable vertices start new trees with no preceding vertex. (MST and TSP)
+    void buildPrimTable(bool isMST);
+    
+    // Helper function that finds which fragment of the greedy tour a location is in.
+    int findFragment(int v) {
+        while (fragmentParent[v] != v) {
+            fragmentParent[v] = fragmentParent[fragmentParent[v]];
+            v = fragmentParent[v];
+        }
+        return v;
+    }
+    
+    // Helper function that adds an edge to the greedy tour if it keeps the tour
+    // a set of paths. Returns whether the edge was added.
+    bool addGreedyEdge(const Edge& edge) {
+        if (tourDegree[edge.u] == 2 || tourDegree[edge.v] == 2) {
+            return 0;
+        }
+        int fragmentU = findFragment(edge.u);
+        int fragmentV = findFragment(edge.v);
+        if (fragmentU == fragmentV) {
+            return 0;
+        }
+        fragmentParent[fragmentU] = fragmentV;
+        ++ tourDegree[edge.u];
+        ++ tourDegree[edge.v];
+        tourNeighbors[edge.u].push_back(edge.v);
+        tourNeighbors[edge.v].push_back(edge.u);
+        return 1;
+    }
+    
+    // Helper function that gives the path of a file in the tile directory. (Out-of-core MST)
+    string tilePath(const string& name) {
+        return tileDirectory + "/" + name;
+    }
+    
+    // Helper function that gives the path of a tile file. (Out-of-core MST)
+    string tilePath(int tile) {
+        return tilePath("tile-" + to_string(tile) + ".bin");
+    }
+    
+    // Helper function that gives the longest side of the bounding box, which the
+    // square grid of tiles covers in both directions. (Out-of-core MST)
+    long long findMaxSpan() {
+        return max(static_cast<long long>(maxX) - minX, static_cast<long long>(maxY) - minY) + 1;
+    }
+    
+    // Helper function that gives the tile a location is binned into. (Out-of-core MST)
+    int findTile(const TilePoint& point) {
+        long long maxSpan = findMaxSpan();
+        int tileX = static_cast<int>((static_cast<long long>(point.x) - minX) * tilesPerSide / maxSpan);
+        int tileY = static_cast<int>((static_cast<long long>(point.y) - minY) * tilesPerSide / maxSpan);
+        return tileY * tilesPerSide + tileX;
+    }
+    
+    // Helper function that gives the side of a square tile. An edge shorter than
+    // this joins locations in the same or adjacent tiles. (Out-of-core MST)
+    double calculateTileSide() {
+        if (tilesPerSide == 1) {
+            return INF;
+        }
+        return static_cast<double>(findMaxSpan()) / tilesPerSide;
+    }
+    
+    // Helper function that gives the shortest distance any two locations in two
+    // tiles could be apart. (Out-of-core MST)
+    double calculateTileDistance(int A, int B) {
+        double tileSide = static_cast<double>(findMaxSpan()) / tilesPerSide;
+        int gapX = max(0, abs(A % tilesPerSide - B % tilesPerSide) - 1);
+        int gapY = max(0, abs(A / tilesPerSide - B / tilesPerSide) - 1);
+        return tileSide * sqrt(static_cast<double>(gapX * gapX + gapY * gapY));
+    }
+    
+    // Helper function that orders edges by weight, breaking ties by location so every
+    // tree agrees on its shortest edge. (Out-of-core MST)
+    bool isShorterEdge(const Edge& A, const Edge& B) {
+        if (A.weight != B.weight) {
+            return A.weight < B.weight;
+        }
+        if (A.u != B.u) {
+            return A.u < B.u;
+        }
+        return A.v < B.v;
+    }
+    
+    // Helper function that gives the batch entry of a tree, or null if the tree is
+    // not in the batch. (Out-of-core MST)
+    TreeEdge* findBatchTree(int root, vector<TreeEdge>& batch) {
+        auto tree = lower_bound(batch.begin(), batch.end(), root, [](const TreeEdge& A, int B) {
+            return A.root < B;
+        });
+        return (tree != batch.end() && tree->root == root) ? &*tree : nullptr;
+    }
+    
+    // Helper function that keeps an edge out of a batch tree if it is the shortest yet. (Out-of-core MST)
+    void updateShortestEdge(int fragment, const Edge& edge, vector<TreeEdge>& batch) {
+        TreeEdge* tree = findBatchTree(fragment, batch);
+        if (tree != nullptr && isShorterEdge(edge, tree->edge)) {
+            tree->edge = edge;
+        }
+    }
+    
+    // Helper function that gives the memory left for tiles once the fragment of
+    // every location is kept. (Out-of-core MST)
+    size_t tileBudget() {
+        size_t fragmentBytes = static_cast<size_t>(numLocations) * sizeof(int);
+        if (memoryLimit <= fragmentBytes) {
+            cerr << "Error: Memory limit too small\n";
+            exit(1);
+        }
+        return memoryLimit - fragmentBytes;
+    }
+    
+    // Helper function that gives the memory left for buffers once the size of every
+    // tile, the tiles connectComponents() sorts, and the two single files any pass
+    // has open are kept. (Out-of-core MST)
+    size_t bufferBudget() {
+        size_t numTiles = static_cast<size_t>(tilesPerSide) * static_cast<size_t>(tilesPerSide);
+        size_t tableBytes = numTiles * (sizeof(size_t) + sizeof(int)) + 2 * (sizeof(fstream) + BUFSIZ);
+        size_t budget = tileBudget();
+        if (budget <= tableBytes) {
+            cerr << "Error: Memory limit too small\n";
+            if (!tileDirectory.empty()) {
+                removeTileDirectory();
+            }
+            exit(1);
+        }
+        return budget - tableBytes;
+    }
+    
+    // Helper function that gives the part of the buffer budget kept for the shortest
+    // edges out of a batch of trees in connectComponents(). (Out-of-core MST)
+    size_t treeBudget() {
+        return bufferBudget() / 8;
+    }
+    
+    // Helper function that gives the most locations a tile can hold so two tiles
+    // and a batch of trees fit in the buffer budget at once. (Out-of-core MST)
+    size_t tileCapacity() {
+        return (bufferBudget() - treeBudget()) / (2 * (sizeof(coordinate) + sizeof(Prim) + sizeof(int)));
+    }
+    
+    // Helper function that reserves room for two tiles up front, so loading a
+    // tile never reallocates. (Out-of-core MST)
+    void reserveTiles() {
+        size_t capacity = 2 * tileCapacity();
+        droneLocations.reserve(capacity);
+        tileIndices.reserve(capacity);
+        primTable.reserve(capacity);
+    }
+    
+    // Helper function that frees the room reserved for tiles. (Out-of-core MST)
+    void releaseTiles() {
+        droneLocations.clear();
+        droneLocations.shrink_to_fit();
+        tileIndices.clear();
+        tileIndices.shrink_to_fit();
+        primTable.clear();
+        primTable.shrink_to_fit();
+    }
+    
+    // Helper function that gives the path of a sorted run of candidate edges. (Out-of-core MST)
+    string runPath(int run) {
+        return tilePath("run-" + to_string(run) + ".bin");
+    }
+    
+    // Helper functions for each pass of the out-of-core MST.
+    void binTiles();
+    void loadTile(int tile);
+    void writeTileEdges(ofstream& candidates, size_t split);
+    void sortCandidates();
+    void mergeCandidates();
+    void openRuns(int firstRun, int lastRun, vector<ifstream>& runFiles,
+                  priority_queue<RunEdge, vector<RunEdge>, RunEdgeComp>& smallestEdges);
+    Edge popSmallestEdge(vector<ifstream>& runFiles, priority_queue<RunEdge, vector<RunEdge>, RunEdgeComp>& smallestEdges);
+    void closeRuns(int firstRun, int lastRun, vector<ifstream>& runFiles);
+    void connectComponents();
+    void findShortestEdges(vector<TreeEdge>& batch, vector<int>& otherTiles);
+    double findLongestShortestEdge(size_t split, vector<TreeEdge>& batch);
+    void removeTileDirectory();
+    
+    // Helper function that calculates total weight of a cycle. (OPT)
+    double calculatePathWeight(const vector<int>& path) {
+        double weight = 0;
+        for (int i = 0; i < numLocations; ++ i) {
+            weight += distanceMatrix[path[i]][path[(i + 1) % numLocations]];
+        }
+        return weight;
+    }
+    
+    // Helper function that starts a tour at location 0 and orients it so the second
+    // location is smaller than the last. (OPT)
+    void orientTour(vector<int>& path) {
+        rotate(path.begin(), find(path.begin(), path.end(), 0), path.end());
+        if (path.size() > 2 && path[1] > path.back()) {
+            reverse(path.begin() + 1, path.end());
+        }
+    }
+    
+    // Helper function that checks if an oriented tour beats the best tour, either
+    // by weight or, when they tie, by lexicographic order. (OPT)
+    bool isBetterTour(const vector<int>& path, double weight) {
+        if (weight < bestWeight - tieTolerance) {
+            return 1;
+        }
+        return weight <= bestWeight + tieTolerance && path < bestPath;
+    }
+    
+    // Helper function that gives the path of a file in the shard directory. (Sharded OPTTSP)
+    string shardPath(const string& name) {
+        return shardDirectory + "/" + name;
+    }
+    
+    // Helper function that gives the path of a shard file. (Sharded OPTTSP)
+    string shardPath(int shard) {
+        return shardPath("shard-" + to_string(shard) + ".bin");
+    }
+    
+    // Helper function that lowers the upper bound to the best tour any worker
+    // has found. (Sharded OPTTSP)
+    void pullSharedBound() {
+        if (sharedSearch != nullptr) {
+            upperBound = min(upperBound, sharedSearch->upperBound.load(memory_order_relaxed));
+        }
+    }
+    
+    // Helper function that publishes a better upper bound to every worker. (Sharded OPTTSP)
+    void publishSharedBound() {
+        if (sharedSearch != nullptr) {
+            double shared = sharedSearch->upperBound.load();
+            while (upperBound < shared && !sharedSearch->upperBound.compare_exchange_weak(shared, upperBound)) {
+            }
+        }
+    }
+    
+    // Helper functions for the coordinator and workers of the sharded OPTTSP.
+    void genShards(size_t permLength, vector<ofstream>& shardFiles, size_t& numPrefixes);
+    void runWorker(int worker);
+    
     // Helper function that sets up the distance matrix to be used in OPT.
     void processDistanceMatrix() {
         vector<double> a(numLocations, 0);
@@ -308,7 +727,7 @@ private:
         primTable.clear();
         
         
-        if (totalWeight + mstTotal < upperBound) {
+        if (totalWeight + mstTotal < upperBound + tieTolerance) {
             return 1;
         }
         else {